@@ -1,6 +1,7 @@
 /* MINIMIDI by Tré Dudman
  * STB style header library.
- * Only handles MIDI input on Windows & MacOS, skipping SYSEX messages.
+ * Only handles MIDI input, skipping SYSEX messages. Windows & MacOS read from MIDI devices.
+ * Linux receives MIDI over the network as RTP-MIDI (RFC 6295) packets on a UDP port.
  *
  * DOCS:
  * #define MINIMIDI_IMPL once in your project to get the OS specific implementation
@@ -10,6 +11,15 @@
  *
  * #define MINIMIDI_MALLOC & MINIMIDI_FREE to use your own allocator
  * #define MINIMIDI_ASSERT to use your own assert
+ *
+ * MIDI clock, Start/Stop/Continue, Song Position & MTC quarter frames are consumed as they arrive and are not pushed
+ * to the ring buffer. Read the followed transport with minimidi_get_transport().
+ * #define MINIMIDI_KEEP_SYNC_MESSAGES to also receive them with minimidi_read_message()
+ *
+ * #define MINIMIDI_NET_PORT to change the UDP port minimidi_connect_port() listens on (Linux only)
+ * #define MINIMIDI_NET_CLOCK_RATE to match the RTP timestamp rate of your sender (Linux only)
+ * The Linux implementation needs POSIX & BSD extensions (clock_gettime(), syscall()). GNU C modes (eg. -std=gnu99)
+ * enable them by default. With strict modes like -std=c99, compile with -D_DEFAULT_SOURCE
  */
 
 #ifdef __cplusplus
@@ -22,6 +32,14 @@ extern "C" {
 #define MINIMIDI_RINGBUFFER_SIZE 128
 #endif
 
+#ifndef MINIMIDI_NET_PORT
+#define MINIMIDI_NET_PORT 5004
+#endif
+
+#ifndef MINIMIDI_NET_CLOCK_RATE
+#define MINIMIDI_NET_CLOCK_RATE 10000
+#endif
+
 #include <stddef.h>
 
 typedef struct MiniMIDI MiniMIDI;
@@ -57,6 +75,32 @@ int minimidi_should_reconnect(MiniMIDI* mm);
 int minimidi_try_reconnect(MiniMIDI* mm, const char* portName);
 #endif
 
+#ifdef __linux__
+/* Linux has a single port, the network. minimidi_connect_port() listens on MINIMIDI_NET_PORT on all interfaces.
+   Packets are drained in batches on a background thread and pushed to the same ring buffer as other platforms.
+   Only raw RTP-MIDI is handled, session management (eg. AppleMIDI invitations) is left to the sender.
+   Use this function to choose the interface & UDP port yourself.
+   Returns 0 on success */
+int minimidi_net_connect(MiniMIDI* mm, const char* address, unsigned short udpPort);
+
+typedef struct MiniMIDINetStats
+{
+    unsigned int numPackets;
+    unsigned int numMessages;
+    /* Packets missing from the sequence. Note offs are recovered from the senders journal when possible */
+    unsigned int numLost;
+    /* Packets arriving after a later packet. These are dropped */
+    unsigned int numReordered;
+    /* Messages replayed from recovery journals */
+    unsigned int numRecovered;
+    /* RFC 3550 interarrival jitter, in microseconds */
+    unsigned int jitterUs;
+} MiniMIDINetStats;
+
+/* Safe to call from any thread while connected. Counters reset when connecting */
+MiniMIDINetStats minimidi_net_get_stats(MiniMIDI* mm);
+#endif
+
 typedef struct MiniMIDIMessage
 {
     union
@@ -79,6 +123,33 @@ MiniMIDIMessage minimidi_read_message(MiniMIDI* mm);
 
 unsigned minimidi_calc_num_bytes_from_status(unsigned char status_byte);
 
+typedef struct MiniMIDITransport
+{
+    /* Tempo filtered from the 24ppqn MIDI clock. 0 until 2 clocks have arrived */
+    double bpm;
+    /* Quarter notes since the start of the song, at 'timestampMs'. While stopped, this is where playback resumes.
+       While playing, extrapolate with: ppqPosition + (nowMs - timestampMs) * bpm / 60000 */
+    double       ppqPosition;
+    unsigned int timestampMs;
+    int          playing;
+
+    /* MIDI Time Code assembled from 8 quarter frames. 0 until a full set has arrived.
+       Sets running forwards (pieces 0 to 7) and backwards (7 to 0) are both followed */
+    int           mtcValid;
+    /* When the first quarter frame of the set arrived, which is the moment the time below refers to.
+       It is 2 frames old by the time the set completes, extrapolate with (nowMs - mtcTimestampMs) */
+    unsigned int  mtcTimestampMs;
+    unsigned char hours;
+    unsigned char minutes;
+    unsigned char seconds;
+    unsigned char frames;
+    /* 0 = 24fps, 1 = 25fps, 2 = 29.97fps drop frame, 3 = 30fps */
+    unsigned char frameRateType;
+} MiniMIDITransport;
+
+/* Latest transport followed from the MIDI input. Wait free, but only a single thread may read it */
+MiniMIDITransport minimidi_get_transport(MiniMIDI* mm);
+
 #endif /* MINIMIDI_H */
 
 #define MINIMIDI_IMPL
@@ -109,6 +180,40 @@ typedef struct MiniMIDIRingBuffer
     MiniMIDIMessage buffer[MINIMIDI_RINGBUFFER_SIZE];
 } MiniMIDIRingBuffer;
 
+/* Follows an external clock master from the thread receiving MIDI */
+typedef struct MiniMIDITransportTracker
+{
+    MiniMIDITransport state;
+
+    /* The next clock to play, in 24ppqn. Start, Stop & Song Position leave it on the tick that playback resumes at */
+    unsigned int clockTicks;
+    int          numClocks;
+    unsigned int lastClockMs;
+    /* Delay locked loop. http://kokkinizita.linuxaudio.org/papers/usingdll.pdf */
+    double dllTime;
+    double dllNextTime;
+    double dllPeriod;
+
+    unsigned char mtcPieces[8];
+    unsigned int  mtcReceived;
+    unsigned int  mtcLastPiece;
+    unsigned int  mtcStartMs;
+
+    /* Triple buffer. The receiving thread writes to slots[backIndex] then swaps it with the middle slot.
+       The reader swaps the middle slot with its front slot when MINIMIDI_TRANSPORT_DIRTY is set */
+    MiniMIDITransport slots[3];
+    int               backIndex;
+    int               frontIndex;
+    volatile int      middleIndex;
+} MiniMIDITransportTracker;
+
+/* Returns 1 when the message was consumed and shouldn't be pushed to the ring buffer */
+static int  minimidi_transport_process(MiniMIDITransportTracker* tracker, MiniMIDIMessage msg);
+/* Sets up the triple buffer. Only call before any thread is reading or writing */
+static void minimidi_transport_init(MiniMIDITransportTracker* tracker);
+/* Clears the writer state and publishes an empty snapshot. Safe while a reader is in minimidi_get_transport() */
+static void minimidi_transport_reset(MiniMIDITransportTracker* tracker);
+
 unsigned minimidi_calc_num_bytes_from_status(unsigned char status_byte)
 {
     /* https://www.midi.org/specifications-old/item/table-2-expanded-messages-list-status-bytes  */
@@ -141,17 +246,20 @@ struct MiniMIDI
     UInt64      connectionStartNanos;
     CFStringRef connectedPortName;
 
-    MiniMIDIRingBuffer ringBuffer;
+    MiniMIDIRingBuffer       ringBuffer;
+    MiniMIDITransportTracker transport;
 };
 
 int  minimidi_atomic_load_i32(const volatile int* ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
 void minimidi_atomic_store_i32(volatile int* ptr, int v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
+int  minimidi_atomic_exchange_i32(volatile int* ptr, int v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
 
 int minimidi_init(MiniMIDI* mm)
 {
     OSStatus error;
 
     memset(mm, 0, sizeof(*mm));
+    minimidi_transport_init(&mm->transport);
     /* TODO: try and create string here without allocating */
     mm->clientName = CFStringCreateWithCString(NULL, "MiniMIDI Input Client", kCFStringEncodingASCII);
     error          = MIDIClientCreate(mm->clientName, NULL, NULL, &mm->clientRef);
@@ -248,10 +356,13 @@ static void minimidi_readProc(const MIDIPacketList* pktlist, void* readProcRefCo
             if (numMsgBytes == 3)
                 message.data2 = bytes[2];
 
-            mm->ringBuffer.buffer[writePos] = message;
-            writePos++;
-            writePos = writePos % ARRSIZE(mm->ringBuffer.buffer);
-            minimidi_atomic_store_i32(&mm->ringBuffer.writePos, writePos);
+            if (! minimidi_transport_process(&mm->transport, message))
+            {
+                mm->ringBuffer.buffer[writePos] = message;
+                writePos++;
+                writePos = writePos % ARRSIZE(mm->ringBuffer.buffer);
+                minimidi_atomic_store_i32(&mm->ringBuffer.writePos, writePos);
+            }
 
             bytes          += numMsgBytes;
             remainingBytes -= numMsgBytes;
@@ -268,6 +379,9 @@ int minimidi_connect_port(MiniMIDI* mm, unsigned int portNumber, const char* por
     MINIMIDI_ASSERT(mm->connectedPortName == NULL);
     MINIMIDI_ASSERT(mm->portRef == 0);
 
+    /* Must happen before the port is created, minimidi_readProc may run as soon as it exists */
+    minimidi_transport_reset(&mm->transport);
+
     /* TODO: try and create string here without allocating */
     mm->connectedPortName = CFStringCreateWithCString(NULL, portName, kCFStringEncodingASCII);
     err = MIDIInputPortCreate(mm->clientRef, mm->connectedPortName, minimidi_readProc, mm, &mm->portRef);
@@ -349,7 +463,8 @@ struct MiniMIDI
 
     int connected;
 
-    MiniMIDIRingBuffer ringBuffer;
+    MiniMIDIRingBuffer       ringBuffer;
+    MiniMIDITransportTracker transport;
     /* Both LibreMidi and RtMidi use 4 headers.
        Can't hurt to copy them right? */
     MiniMIDIBuffer buffers[MINIMIDI_MIDI_BUFFER_COUNT];
@@ -357,11 +472,13 @@ struct MiniMIDI
 
 int  minimidi_atomic_load_i32(volatile int* ptr) { return _InterlockedCompareExchange((volatile LONG*)ptr, 0, 0); }
 void minimidi_atomic_store_i32(volatile int* ptr, int v) { _InterlockedExchange((volatile LONG*)ptr, v); }
+int  minimidi_atomic_exchange_i32(volatile int* ptr, int v) { return _InterlockedExchange((volatile LONG*)ptr, v); }
 
 int minimidi_init(MiniMIDI* mm)
 {
     int i;
     memset(mm, 0, sizeof(*mm));
+    minimidi_transport_init(&mm->transport);
 
     for (i = 0; i < ARRSIZE(mm->buffers); i++)
     {
@@ -423,6 +540,9 @@ minimidi_MidiInProc(HMIDIIN hMidiIn, UINT wMsg, DWORD_PTR dwInstance, DWORD_PTR
         msg.bytesAsInt  = dwParam1 & 0xffffff;
         msg.timestampMs = dwParam2;
 
+        if (minimidi_transport_process(&mm->transport, msg))
+            return;
+
         writePos = minimidi_atomic_load_i32(&mm->ringBuffer.writePos);
 
         mm->ringBuffer.buffer[writePos] = msg;
@@ -459,6 +579,7 @@ int minimidi_connect_port(MiniMIDI* mm, unsigned int portNumber, const char* por
     int              i;
     CM_NOTIFY_FILTER notifyFilter;
 
+    minimidi_transport_reset(&mm->transport);
     result =
         midiInOpen(&mm->midiInHandle, portNumber, (DWORD_PTR)&minimidi_MidiInProc, (DWORD_PTR)mm, CALLBACK_FUNCTION);
 
@@ -546,6 +667,585 @@ int minimidi_try_reconnect(MiniMIDI* mm, const char* portName)
 
 #endif /* _WIN32 */
 
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__STRICT_ANSI__) && ! defined(_DEFAULT_SOURCE) && ! defined(_GNU_SOURCE)
+#error "minimidi needs POSIX & BSD extensions on Linux. Compile with -D_DEFAULT_SOURCE or a GNU C mode"
+#endif
+
+/* Same layout as glibc's struct mmsghdr. Both it and recvmmsg() need _GNU_SOURCE, so we declare the struct ourselves
+   and call recvmmsg() through syscall(), which only needs _DEFAULT_SOURCE */
+typedef struct MiniMIDIMmsghdr
+{
+    struct msghdr msg_hdr;
+    unsigned int  msg_len;
+} MiniMIDIMmsghdr;
+
+#define MINIMIDI_NET_BATCH_COUNT 16
+#define MINIMIDI_NET_POLL_MS 50
+/* If a senders clock drifts this far from ours, we stop trusting it and re-align to our clock */
+#define MINIMIDI_NET_RESYNC_MS 1000
+/* Sequence number windows from RFC 3550 A.1. Jumps forward by less than MAX_DROPOUT are losses, packets up to
+   MAX_MISORDER behind are late. Anything else is a restarted sender, once the following packet continues from it */
+#define MINIMIDI_NET_MAX_DROPOUT 3000
+#define MINIMIDI_NET_MAX_MISORDER 100
+/* Larger than any sequence number, so it never matches */
+#define MINIMIDI_NET_NO_BAD_SEQ 0x10001
+
+struct MiniMIDI
+{
+    int       sock;
+    pthread_t thread;
+    int       connected;
+    /* set to 0 to stop the receive thread */
+    volatile int running;
+
+    unsigned long long connectionStartUs;
+
+    /* RTP session state. Only touched by the receive thread */
+    int                haveSource;
+    unsigned int       ssrc;
+    unsigned short     expectedSeq;
+    /* Sequence number that would confirm a sender restart, or MINIMIDI_NET_NO_BAD_SEQ */
+    unsigned int       badSeq;
+    unsigned int       anchorRtp;
+    unsigned int       anchorMs;
+    int                haveTransit;
+    long long          lastTransitUs;
+    unsigned long long jitterUs16; /* jitter scaled by 16, as in RFC 3550 A.8 */
+    /* One bit per note & channel, set while the note is held. Recovery journals are compared against this */
+    unsigned char noteStates[16][128 / 8];
+
+    MiniMIDINetStats         stats;
+    MiniMIDIRingBuffer       ringBuffer;
+    MiniMIDITransportTracker transport;
+
+    /* recvmmsg() lets us drain several packets per syscall */
+    MiniMIDIMmsghdr headers[MINIMIDI_NET_BATCH_COUNT];
+    struct iovec    iovecs[MINIMIDI_NET_BATCH_COUNT];
+    unsigned char   buffers[MINIMIDI_NET_BATCH_COUNT][MINIMIDI_MIDI_BUFFER_SIZE];
+};
+
+int  minimidi_atomic_load_i32(const volatile int* ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+void minimidi_atomic_store_i32(volatile int* ptr, int v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
+int  minimidi_atomic_exchange_i32(volatile int* ptr, int v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
+
+static void minimidi_net_stat_add(unsigned int* stat, unsigned int n) { __atomic_fetch_add(stat, n, __ATOMIC_RELAXED); }
+
+static unsigned long long minimidi_net_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int minimidi_init(MiniMIDI* mm)
+{
+    int i;
+    memset(mm, 0, sizeof(*mm));
+    mm->sock = -1;
+    minimidi_transport_init(&mm->transport);
+
+    for (i = 0; i < ARRSIZE(mm->headers); i++)
+    {
+        mm->iovecs[i].iov_base            = &mm->buffers[i][0];
+        mm->iovecs[i].iov_len             = ARRSIZE(mm->buffers[i]);
+        mm->headers[i].msg_hdr.msg_iov    = &mm->iovecs[i];
+        mm->headers[i].msg_hdr.msg_iovlen = 1;
+    }
+    return 0;
+}
+
+MiniMIDI* minimidi_create()
+{
+    MiniMIDI* mm = (MiniMIDI*)MINIMIDI_MALLOC(NULL, sizeof(MiniMIDI));
+    minimidi_init(mm);
+    return mm;
+}
+
+void minimidi_free(MiniMIDI* mm)
+{
+    MINIMIDI_ASSERT(mm != NULL);
+    minimidi_disconnect_port(mm);
+#ifndef MINIMIDI_USE_GLOBAL
+    MINIMIDI_FREE(NULL, mm);
+#endif
+}
+
+unsigned long minimidi_get_num_ports(MiniMIDI* mm) { return 1; }
+
+int minimidi_get_port_name(MiniMIDI* mm, unsigned int portNumber, char* nameBuffer, size_t bufferSize)
+{
+    int len;
+    if (portNumber != 0 || bufferSize == 0)
+        return 1;
+    len = snprintf(nameBuffer, bufferSize, "RTP-MIDI (UDP port %u)", MINIMIDI_NET_PORT);
+    return len < 0 || (size_t)len >= bufferSize;
+}
+
+static int minimidi_net_is_note_on(MiniMIDI* mm, unsigned channel, unsigned note)
+{
+    return (mm->noteStates[channel][note >> 3] >> (note & 7)) & 1;
+}
+
+static void minimidi_net_push(MiniMIDI* mm, int* writePos, MiniMIDIMessage msg)
+{
+    unsigned char* noteState = &mm->noteStates[msg.status & 0x0f][(msg.data1 & 0x7f) >> 3];
+    unsigned char  noteBit   = 1 << (msg.data1 & 7);
+
+    if ((msg.status & 0xf0) == 0x90 && msg.data2 != 0)
+        *noteState |= noteBit;
+    else if ((msg.status & 0xf0) == 0x80 || (msg.status & 0xf0) == 0x90)
+        *noteState &= ~noteBit;
+
+    mm->ringBuffer.buffer[*writePos] = msg;
+    *writePos                        = (*writePos + 1) % ARRSIZE(mm->ringBuffer.buffer);
+    minimidi_atomic_store_i32(&mm->ringBuffer.writePos, *writePos);
+}
+
+/* Converts an RTP timestamp to milliseconds since connecting, following the senders clock */
+static unsigned int minimidi_net_calc_timestamp_ms(MiniMIDI* mm, unsigned int rtpTime)
+{
+    long long ticks = (int)(rtpTime - mm->anchorRtp);
+    long long ms    = mm->anchorMs + ticks * 1000 / MINIMIDI_NET_CLOCK_RATE;
+    return ms < 0 ? 0 : (unsigned int)ms;
+}
+
+/* Journals are only read after packet loss. Chapter N (note on/off) describes every note since the checkpoint packet,
+   which usually includes packets we've already handled. Only notes that differ from our own note states are replayed,
+   so held notes aren't triggered twice and notes never hang. All other chapters are skipped.
+   https://www.rfc-editor.org/rfc/rfc6295#appendix-A */
+static void minimidi_net_read_journal(
+    MiniMIDI*            mm,
+    int*                 writePos,
+    const unsigned char* bytes,
+    unsigned             numBytes,
+    unsigned int         timestampMs)
+{
+    unsigned        pos = 3;
+    unsigned        numChannels, i;
+    MiniMIDIMessage msg;
+
+    if (numBytes < 3)
+        return;
+
+    msg.bytesAsInt  = 0;
+    msg.timestampMs = timestampMs;
+    numChannels     = (bytes[0] & 0x0f) + 1;
+
+    /* Y: system journal */
+    if (bytes[0] & 0x40)
+    {
+        if (pos + 2 > numBytes)
+            return;
+        pos += ((bytes[pos] & 0x03) << 8) | bytes[pos + 1];
+    }
+    /* A: channel journals */
+    if ((bytes[0] & 0x20) == 0)
+        return;
+
+    for (i = 0; i < numChannels; i++)
+    {
+        unsigned channel, length, chapters, chapterPos, end;
+
+        if (pos + 3 > numBytes)
+            return;
+        channel  = (bytes[pos] >> 3) & 0x0f;
+        length   = ((bytes[pos] & 0x03) << 8) | bytes[pos + 1];
+        chapters = bytes[pos + 2];
+        end      = pos + length;
+        if (length < 3 || end > numBytes)
+            return;
+
+        chapterPos = pos + 3;
+        /* P: program change */
+        if (chapters & 0x80)
+            chapterPos += 3;
+        /* C: control change */
+        if ((chapters & 0x40) && chapterPos < end)
+            chapterPos += 1 + ((bytes[chapterPos] & 0x7f) + 1) * 2;
+        /* M: parameter system */
+        if ((chapters & 0x20) && chapterPos + 2 <= end)
+            chapterPos += ((bytes[chapterPos] & 0x03) << 8) | bytes[chapterPos + 1];
+        /* W: pitch wheel */
+        if (chapters & 0x10)
+            chapterPos += 2;
+        /* N: note on/off */
+        if ((chapters & 0x08) && chapterPos + 2 <= end)
+        {
+            unsigned numLogs = bytes[chapterPos] & 0x7f;
+            unsigned low     = bytes[chapterPos + 1] >> 4;
+            unsigned high    = bytes[chapterPos + 1] & 0x0f;
+            unsigned j;
+
+            if (numLogs == 127 && low == 15 && high == 0)
+                numLogs = 128;
+            chapterPos += 2;
+
+            for (j = 0; j < numLogs && chapterPos + 2 <= end; j++, chapterPos += 2)
+            {
+                /* Y bit: the sender recommends playing this note on */
+                if ((bytes[chapterPos + 1] & 0x80) == 0)
+                    continue;
+                msg.status = 0x90 | channel;
+                msg.data1  = bytes[chapterPos] & 0x7f;
+                msg.data2  = bytes[chapterPos + 1] & 0x7f;
+                if (msg.data2 == 0 || minimidi_net_is_note_on(mm, channel, msg.data1))
+                    continue;
+                minimidi_net_push(mm, writePos, msg);
+                minimidi_net_stat_add(&mm->stats.numRecovered, 1);
+            }
+            /* OFFBITS: one bit per note, starting from note 8 * LOW in the MSB */
+            for (j = low; j <= high && chapterPos < end; j++, chapterPos++)
+            {
+                unsigned bit;
+                for (bit = 0; bit < 8; bit++)
+                {
+                    if ((bytes[chapterPos] & (0x80 >> bit)) == 0)
+                        continue;
+                    if (! minimidi_net_is_note_on(mm, channel, j * 8 + bit))
+                        continue;
+                    msg.status = 0x80 | channel;
+                    msg.data1  = j * 8 + bit;
+                    msg.data2  = 64;
+                    minimidi_net_push(mm, writePos, msg);
+                    minimidi_net_stat_add(&mm->stats.numRecovered, 1);
+                }
+            }
+        }
+        pos = end;
+    }
+}
+
+/* https://www.rfc-editor.org/rfc/rfc6295#section-3 */
+static void minimidi_net_read_commands(
+    MiniMIDI*            mm,
+    int*                 writePos,
+    const unsigned char* bytes,
+    unsigned             numBytes,
+    int                  firstHasDelta,
+    unsigned int         rtpTime)
+{
+    unsigned        pos           = 0;
+    unsigned int    deltaTicks    = 0;
+    unsigned char   runningStatus = 0;
+    int             first         = 1;
+    MiniMIDIMessage msg;
+
+    while (pos < numBytes)
+    {
+        unsigned numMsgBytes;
+
+        /* Delta times are 1-4 bytes, 7 bits each, high bit set on all but the last.
+           Each delta is relative to the previous command, so they add up */
+        if (! first || firstHasDelta)
+        {
+            unsigned     i;
+            unsigned int delta = 0;
+            for (i = 0; i < 4 && pos < numBytes; i++)
+            {
+                unsigned char b = bytes[pos++];
+                delta           = (delta << 7) | (b & 0x7f);
+                if ((b & 0x80) == 0)
+                    break;
+            }
+            deltaTicks += delta;
+            if (pos >= numBytes)
+                return;
+        }
+        first = 0;
+
+        msg.bytesAsInt = 0;
+        if (bytes[pos] >= 0x80)
+        {
+            msg.status = bytes[pos++];
+            /* System common messages cancel running status, realtime messages don't */
+            if (msg.status < 0xf0)
+                runningStatus = msg.status;
+            else if (msg.status < 0xf8)
+                runningStatus = 0;
+        }
+        else if (runningStatus != 0)
+            msg.status = runningStatus;
+        else
+            return;
+
+        /* Skip SYSEX, including segmented SYSEX */
+        if (msg.status == 0xf0 || msg.status == 0xf7)
+        {
+            while (pos < numBytes && bytes[pos] != 0xf7 && bytes[pos] != 0xf0 && bytes[pos] != 0xf4)
+                pos++;
+            pos++;
+            continue;
+        }
+
+        numMsgBytes = minimidi_calc_num_bytes_from_status(msg.status);
+        if (pos + numMsgBytes - 1 > numBytes)
+            return;
+        if (numMsgBytes != 1)
+            msg.data1 = bytes[pos];
+        if (numMsgBytes == 3)
+            msg.data2 = bytes[pos + 1];
+        pos += numMsgBytes - 1;
+
+        msg.timestampMs = minimidi_net_calc_timestamp_ms(mm, rtpTime + deltaTicks);
+        minimidi_net_stat_add(&mm->stats.numMessages, 1);
+        if (! minimidi_transport_process(&mm->transport, msg))
+            minimidi_net_push(mm, writePos, msg);
+    }
+}
+
+/* https://www.rfc-editor.org/rfc/rfc3550#section-5.1 */
+static void minimidi_net_read_packet(MiniMIDI* mm, const unsigned char* bytes, unsigned numBytes, unsigned long long nowUs)
+{
+    unsigned       pos = 12;
+    unsigned       cmdLen;
+    unsigned char  cmdHeader;
+    unsigned short seq;
+    unsigned int   rtpTime, ssrc, nowMs, secs;
+    int            recover = 0, writePos;
+    long long      transitUs, diffUs;
+
+    if (numBytes < 13 || (bytes[0] >> 6) != 2)
+        return;
+    /* Padding */
+    if (bytes[0] & 0x20)
+    {
+        if (bytes[numBytes - 1] >= numBytes - pos)
+            return;
+        numBytes -= bytes[numBytes - 1];
+    }
+    /* CSRC list & header extension */
+    pos += (bytes[0] & 0x0f) * 4;
+    if (bytes[0] & 0x10)
+    {
+        if (pos + 4 > numBytes)
+            return;
+        pos += 4 + ((bytes[pos + 2] << 8) | bytes[pos + 3]) * 4;
+    }
+    if (pos >= numBytes)
+        return;
+
+    seq     = (bytes[2] << 8) | bytes[3];
+    rtpTime = ((unsigned int)bytes[4] << 24) | (bytes[5] << 16) | (bytes[6] << 8) | bytes[7];
+    ssrc    = ((unsigned int)bytes[8] << 24) | (bytes[9] << 16) | (bytes[10] << 8) | bytes[11];
+    nowMs   = (nowUs - mm->connectionStartUs) / 1000;
+
+    if (mm->haveSource && ssrc == mm->ssrc)
+    {
+        unsigned short gap = seq - mm->expectedSeq;
+        if (gap < MINIMIDI_NET_MAX_DROPOUT)
+        {
+            if (gap != 0)
+            {
+                minimidi_net_stat_add(&mm->stats.numLost, gap);
+                recover = 1;
+            }
+            mm->badSeq = MINIMIDI_NET_NO_BAD_SEQ;
+        }
+        else if (gap >= 0x10000 - MINIMIDI_NET_MAX_MISORDER)
+        {
+            minimidi_net_stat_add(&mm->stats.numReordered, 1);
+            return;
+        }
+        else if (seq == mm->badSeq)
+        {
+            /* Two packets in a row continue from the jump, so the sender restarted with the same SSRC.
+               The packet before this one was dropped while we waited to find out */
+            minimidi_net_stat_add(&mm->stats.numLost, 1);
+            mm->haveSource = 0;
+        }
+        else
+        {
+            mm->badSeq = (unsigned short)(seq + 1);
+            return;
+        }
+    }
+    if (! mm->haveSource || ssrc != mm->ssrc)
+    {
+        mm->haveSource  = 1;
+        mm->ssrc        = ssrc;
+        mm->badSeq      = MINIMIDI_NET_NO_BAD_SEQ;
+        mm->anchorRtp   = rtpTime;
+        mm->anchorMs    = nowMs;
+        mm->haveTransit = 0;
+        memset(mm->noteStates, 0, sizeof(mm->noteStates));
+    }
+    mm->expectedSeq = seq + 1;
+    minimidi_net_stat_add(&mm->stats.numPackets, 1);
+
+    /* Keep the anchor close to the current time so tick math never overflows */
+    secs = (unsigned int)((int)(rtpTime - mm->anchorRtp) / MINIMIDI_NET_CLOCK_RATE);
+    if ((int)secs > 0)
+    {
+        mm->anchorRtp += secs * MINIMIDI_NET_CLOCK_RATE;
+        mm->anchorMs  += secs * 1000;
+    }
+    diffUs = ((long long)minimidi_net_calc_timestamp_ms(mm, rtpTime) - nowMs) * 1000;
+    if (diffUs > MINIMIDI_NET_RESYNC_MS * 1000 || diffUs < -MINIMIDI_NET_RESYNC_MS * 1000)
+    {
+        mm->anchorRtp   = rtpTime;
+        mm->anchorMs    = nowMs;
+        mm->haveTransit = 0;
+    }
+
+    /* Interarrival jitter. https://www.rfc-editor.org/rfc/rfc3550#appendix-A.8 */
+    transitUs = (long long)(nowUs - mm->connectionStartUs) -
+                ((long long)mm->anchorMs * 1000 +
+                 (long long)(int)(rtpTime - mm->anchorRtp) * 1000000 / MINIMIDI_NET_CLOCK_RATE);
+    if (mm->haveTransit)
+    {
+        diffUs = transitUs - mm->lastTransitUs;
+        if (diffUs < 0)
+            diffUs = -diffUs;
+        mm->jitterUs16 += diffUs - ((mm->jitterUs16 + 8) >> 4);
+        __atomic_store_n(&mm->stats.jitterUs, (unsigned int)(mm->jitterUs16 >> 4), __ATOMIC_RELAXED);
+    }
+    mm->haveTransit   = 1;
+    mm->lastTransitUs = transitUs;
+
+    /* MIDI command section header: B J Z P LEN */
+    cmdHeader = bytes[pos++];
+    cmdLen    = cmdHeader & 0x0f;
+    if (cmdHeader & 0x80)
+    {
+        if (pos >= numBytes)
+            return;
+        cmdLen = (cmdLen << 8) | bytes[pos++];
+    }
+    if (pos + cmdLen > numBytes)
+        return;
+
+    writePos = minimidi_atomic_load_i32(&mm->ringBuffer.writePos);
+    /* The journal describes what happened before this packet, so it must be replayed first */
+    if (recover && (cmdHeader & 0x40))
+        minimidi_net_read_journal(
+            mm,
+            &writePos,
+            bytes + pos + cmdLen,
+            numBytes - pos - cmdLen,
+            minimidi_net_calc_timestamp_ms(mm, rtpTime));
+    minimidi_net_read_commands(mm, &writePos, bytes + pos, cmdLen, cmdHeader & 0x20, rtpTime);
+}
+
+static void* minimidi_net_thread(void* arg)
+{
+    MiniMIDI*     mm = (MiniMIDI*)arg;
+    struct pollfd pfd;
+
+    pfd.fd     = mm->sock;
+    pfd.events = POLLIN;
+
+    while (minimidi_atomic_load_i32(&mm->running))
+    {
+        int numPackets, i;
+
+        /* Wake up every so often to check if we've been asked to stop */
+        if (poll(&pfd, 1, MINIMIDI_NET_POLL_MS) <= 0)
+            continue;
+
+        /* The socket is non-blocking, drain everything that's queued before polling again */
+        do
+        {
+            unsigned long long nowUs;
+
+            numPackets = syscall(SYS_recvmmsg, mm->sock, mm->headers, ARRSIZE(mm->headers), MSG_DONTWAIT, NULL);
+            if (numPackets <= 0)
+                break;
+
+            nowUs = minimidi_net_now_us();
+            for (i = 0; i < numPackets; i++)
+                minimidi_net_read_packet(mm, mm->buffers[i], mm->headers[i].msg_len, nowUs);
+        }
+        while (numPackets == ARRSIZE(mm->headers));
+    }
+    return NULL;
+}
+
+int minimidi_net_connect(MiniMIDI* mm, const char* address, unsigned short udpPort)
+{
+    struct sockaddr_in addr;
+    int                err;
+    MINIMIDI_ASSERT(mm->connected == 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(udpPort);
+    if (inet_pton(AF_INET, address, &addr.sin_addr) != 1)
+        return 1;
+
+    mm->sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (mm->sock < 0)
+        return 1;
+
+    err = bind(mm->sock, (struct sockaddr*)&addr, sizeof(addr));
+    if (err != 0)
+        goto failed;
+
+    mm->haveSource        = 0;
+    memset(mm->noteStates, 0, sizeof(mm->noteStates));
+    mm->jitterUs16        = 0;
+    mm->connectionStartUs = minimidi_net_now_us();
+    memset(&mm->stats, 0, sizeof(mm->stats));
+    minimidi_transport_reset(&mm->transport);
+
+    minimidi_atomic_store_i32(&mm->running, 1);
+    err = pthread_create(&mm->thread, NULL, minimidi_net_thread, mm);
+    if (err != 0)
+        goto failed;
+
+    mm->connected = 1;
+    return 0;
+
+failed:
+    close(mm->sock);
+    mm->sock = -1;
+    return err == 0 ? 1 : err;
+}
+
+int minimidi_connect_port(MiniMIDI* mm, unsigned int portNumber, const char* portName)
+{
+    if (portNumber != 0)
+        return 1;
+    return minimidi_net_connect(mm, "0.0.0.0", MINIMIDI_NET_PORT);
+}
+
+void minimidi_disconnect_port(MiniMIDI* mm)
+{
+    if (mm->connected)
+    {
+        minimidi_atomic_store_i32(&mm->running, 0);
+        pthread_join(mm->thread, NULL);
+        close(mm->sock);
+        mm->sock      = -1;
+        mm->connected = 0;
+    }
+}
+
+MiniMIDINetStats minimidi_net_get_stats(MiniMIDI* mm)
+{
+    MiniMIDINetStats stats;
+    stats.numPackets   = __atomic_load_n(&mm->stats.numPackets, __ATOMIC_RELAXED);
+    stats.numMessages  = __atomic_load_n(&mm->stats.numMessages, __ATOMIC_RELAXED);
+    stats.numLost      = __atomic_load_n(&mm->stats.numLost, __ATOMIC_RELAXED);
+    stats.numReordered = __atomic_load_n(&mm->stats.numReordered, __ATOMIC_RELAXED);
+    stats.numRecovered = __atomic_load_n(&mm->stats.numRecovered, __ATOMIC_RELAXED);
+    stats.jitterUs     = __atomic_load_n(&mm->stats.jitterUs, __ATOMIC_RELAXED);
+    return stats;
+}
+
+#endif /* __linux__ */
+
 MiniMIDIMessage minimidi_read_message(MiniMIDI* mm)
 {
     MiniMIDIMessage msg;
@@ -566,6 +1266,174 @@ MiniMIDIMessage minimidi_read_message(MiniMIDI* mm)
     return msg;
 }
 
+#define MINIMIDI_TRANSPORT_DIRTY 4
+/* Clocks further apart than this (10bpm) restart tempo tracking */
+#define MINIMIDI_CLOCK_TIMEOUT_MS 250
+/* DLL coefficients for a bandwidth of 1/50th the clock rate. w = 2 * pi * 0.02, b = sqrt(2) * w, c = w * w */
+#define MINIMIDI_CLOCK_DLL_B 0.1777
+#define MINIMIDI_CLOCK_DLL_C 0.01579
+
+static void minimidi_transport_init(MiniMIDITransportTracker* tracker)
+{
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->backIndex    = 0;
+    tracker->middleIndex  = 1;
+    tracker->frontIndex   = 2;
+    tracker->mtcLastPiece = 7;
+}
+
+static void minimidi_transport_publish(MiniMIDITransportTracker* tracker)
+{
+    int prev;
+    tracker->slots[tracker->backIndex] = tracker->state;
+    prev = minimidi_atomic_exchange_i32(&tracker->middleIndex, tracker->backIndex | MINIMIDI_TRANSPORT_DIRTY);
+    tracker->backIndex = prev & ~MINIMIDI_TRANSPORT_DIRTY;
+}
+
+static void minimidi_transport_reset(MiniMIDITransportTracker* tracker)
+{
+    /* The slot indices are shared with the reader, so leave them alone */
+    memset(&tracker->state, 0, sizeof(tracker->state));
+    tracker->clockTicks  = 0;
+    tracker->numClocks   = 0;
+    tracker->lastClockMs = 0;
+    tracker->dllTime     = 0;
+    tracker->dllNextTime = 0;
+    tracker->dllPeriod   = 0;
+    memset(tracker->mtcPieces, 0, sizeof(tracker->mtcPieces));
+    tracker->mtcReceived  = 0;
+    tracker->mtcLastPiece = 7;
+    tracker->mtcStartMs   = 0;
+    minimidi_transport_publish(tracker);
+}
+
+static void minimidi_transport_process_clock(MiniMIDITransportTracker* tracker, unsigned int timestampMs)
+{
+    MiniMIDITransport* state = &tracker->state;
+    double             t     = timestampMs;
+
+    if (tracker->numClocks == 0 || timestampMs - tracker->lastClockMs > MINIMIDI_CLOCK_TIMEOUT_MS)
+    {
+        tracker->numClocks = 1;
+        tracker->dllTime   = t;
+    }
+    else if (tracker->numClocks == 1)
+    {
+        /* Millisecond timestamps can put two fast clocks on the same tick */
+        tracker->dllPeriod   = timestampMs != tracker->lastClockMs ? t - tracker->lastClockMs : 1;
+        tracker->dllTime     = t;
+        tracker->dllNextTime = t + tracker->dllPeriod;
+        tracker->numClocks   = 2;
+    }
+    else
+    {
+        double err            = t - tracker->dllNextTime;
+        tracker->dllTime      = tracker->dllNextTime;
+        tracker->dllNextTime += MINIMIDI_CLOCK_DLL_B * err + tracker->dllPeriod;
+        tracker->dllPeriod   += MINIMIDI_CLOCK_DLL_C * err;
+    }
+    tracker->lastClockMs = timestampMs;
+
+    if (tracker->numClocks >= 2 && tracker->dllPeriod > 0)
+        state->bpm = 60000.0 / (tracker->dllPeriod * 24);
+
+    if (state->playing)
+    {
+        state->ppqPosition = tracker->clockTicks / 24.0;
+        state->timestampMs = tracker->dllTime < 0 ? 0 : (unsigned int)(tracker->dllTime + 0.5);
+        tracker->clockTicks++;
+    }
+}
+
+/* https://www.recordingblogs.com/wiki/midi-quarter-frame-message
+   When running backwards, pieces arrive from 7 down to 0 */
+static void minimidi_transport_process_quarter_frame(
+    MiniMIDITransportTracker* tracker,
+    unsigned char             data,
+    unsigned int              timestampMs)
+{
+    MiniMIDITransport*   state     = &tracker->state;
+    const unsigned char* pieces    = tracker->mtcPieces;
+    unsigned             piece     = (data >> 4) & 0x07;
+    int                  forwards  = piece == ((tracker->mtcLastPiece + 1) & 0x07);
+    int                  backwards = piece == ((tracker->mtcLastPiece + 7) & 0x07);
+
+    /* Pieces out of order are only useful when they start a new set */
+    if (! forwards && ! backwards)
+        tracker->mtcReceived = 0;
+    if ((piece == 0 && ! backwards) || (piece == 7 && ! forwards))
+    {
+        tracker->mtcReceived = 0;
+        tracker->mtcStartMs  = timestampMs;
+    }
+    tracker->mtcPieces[piece]  = data & 0x0f;
+    tracker->mtcReceived      |= 1 << piece;
+    tracker->mtcLastPiece      = piece;
+
+    if (tracker->mtcReceived == 0xff && ((piece == 7 && ! backwards) || (piece == 0 && backwards)))
+    {
+        state->mtcTimestampMs = tracker->mtcStartMs;
+        state->frames         = pieces[0] | ((pieces[1] & 0x01) << 4);
+        state->seconds        = pieces[2] | ((pieces[3] & 0x03) << 4);
+        state->minutes        = pieces[4] | ((pieces[5] & 0x03) << 4);
+        state->hours          = pieces[6] | ((pieces[7] & 0x01) << 4);
+        state->frameRateType  = (pieces[7] >> 1) & 0x03;
+        state->mtcValid       = 1;
+    }
+}
+
+static int minimidi_transport_process(MiniMIDITransportTracker* tracker, MiniMIDIMessage msg)
+{
+    MiniMIDITransport* state = &tracker->state;
+
+    switch (msg.status)
+    {
+    case 0xf8: /* Clock */
+        minimidi_transport_process_clock(tracker, msg.timestampMs);
+        break;
+    case 0xfa: /* Start */
+        tracker->clockTicks = 0;
+        /* fallthrough */
+    case 0xfb: /* Continue */
+        state->playing     = 1;
+        state->ppqPosition = tracker->clockTicks / 24.0;
+        state->timestampMs = msg.timestampMs;
+        break;
+    case 0xfc: /* Stop */
+        state->playing     = 0;
+        state->ppqPosition = tracker->clockTicks / 24.0;
+        state->timestampMs = msg.timestampMs;
+        break;
+    case 0xf2: /* Song Position Pointer, in 16th notes */
+        tracker->clockTicks = (msg.data1 | (msg.data2 << 7)) * 6;
+        state->ppqPosition  = tracker->clockTicks / 24.0;
+        state->timestampMs  = msg.timestampMs;
+        break;
+    case 0xf1: /* MTC quarter frame */
+        minimidi_transport_process_quarter_frame(tracker, msg.data1, msg.timestampMs);
+        break;
+    default:
+        return 0;
+    }
+
+    minimidi_transport_publish(tracker);
+#ifdef MINIMIDI_KEEP_SYNC_MESSAGES
+    return 0;
+#else
+    return 1;
+#endif
+}
+
+MiniMIDITransport minimidi_get_transport(MiniMIDI* mm)
+{
+    MiniMIDITransportTracker* tracker = &mm->transport;
+
+    if (minimidi_atomic_load_i32(&tracker->middleIndex) & MINIMIDI_TRANSPORT_DIRTY)
+        tracker->frontIndex =
+            minimidi_atomic_exchange_i32(&tracker->middleIndex, tracker->frontIndex) & ~MINIMIDI_TRANSPORT_DIRTY;
+    return tracker->slots[tracker->frontIndex];
+}
+
 #ifdef MINIMIDI_USE_GLOBAL
 static MiniMIDI g_minimidi;
 MiniMIDI*       minimidi_get_global(void) { return &g_minimidi; }
@@ -0,0 +1,474 @@
+/* Sends RTP-MIDI packets to ourselves over the loopback interface and checks what the receiver made of them.
+   Every so often two packets are swapped, so the receiver sees a loss, recovers it from the next packets journal,
+   then drops the late packet. The sender then restarts its sequence numbers, which the receiver should follow.
+   Afterwards a jittered MIDI clock, transport messages & MTC quarter frames are sent to check the transport tracker.
+   Returns 0 when everything arrived as expected */
+
+#define MINIMIDI_IMPL
+#include "minimidi.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_PACKETS 20000
+#define BURST_SIZE 16 /* 4 messages per packet, must fit in MINIMIDI_RINGBUFFER_SIZE */
+#define SWAP_INTERVAL 64
+#define SSRC 0x6d696e69
+#define CLOCK_BPM 120
+
+#define CHECK(cond, ...)                                                                                               \
+    if (! (cond))                                                                                                      \
+    {                                                                                                                  \
+        printf("FAILED: " __VA_ARGS__);                                                                                \
+        numFailures++;                                                                                                 \
+    }
+
+static int                numFailures = 0;
+static int                sock;
+static struct sockaddr_in addr;
+static unsigned long long startMs;
+static unsigned short     nextSeq;
+/* Packets the receiver should have handled by now, either received or dropped as reordered */
+static unsigned numExpected;
+
+static unsigned long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* RTP timestamps in whole milliseconds, so message timestamps can be checked exactly */
+static unsigned int rtp_now(void) { return (now_ms() - startMs) * (MINIMIDI_NET_CLOCK_RATE / 1000); }
+
+static unsigned build_packet(
+    unsigned char*       buf,
+    unsigned short       seq,
+    unsigned int         rtpTime,
+    const unsigned char* cmds,
+    unsigned             cmdLen,
+    const unsigned char* journal,
+    unsigned             journalLen)
+{
+    unsigned pos = 0;
+
+    buf[pos++] = 0x80; /* V=2 */
+    buf[pos++] = 0x61; /* payload type, dynamic */
+    buf[pos++] = seq >> 8;
+    buf[pos++] = seq;
+    buf[pos++] = rtpTime >> 24;
+    buf[pos++] = rtpTime >> 16;
+    buf[pos++] = rtpTime >> 8;
+    buf[pos++] = rtpTime;
+    buf[pos++] = SSRC >> 24;
+    buf[pos++] = (SSRC >> 16) & 0xff;
+    buf[pos++] = (SSRC >> 8) & 0xff;
+    buf[pos++] = SSRC & 0xff;
+
+    /* Command section header, B=1 for a 12 bit length */
+    buf[pos++] = 0x80 | (journalLen ? 0x40 : 0) | (cmdLen >> 8);
+    buf[pos++] = cmdLen & 0xff;
+    memcpy(buf + pos, cmds, cmdLen);
+    pos += cmdLen;
+    memcpy(buf + pos, journal, journalLen);
+    return pos + journalLen;
+}
+
+static void send_commands(const unsigned char* cmds, unsigned cmdLen, unsigned int rtpTime)
+{
+    unsigned char packet[64];
+    unsigned      len = build_packet(packet, nextSeq++, rtpTime, cmds, cmdLen, NULL, 0);
+    sendto(sock, packet, len, 0, (struct sockaddr*)&addr, sizeof(addr));
+    numExpected++;
+}
+
+static unsigned char note_for_packet(int idx) { return 36 + ((idx % 48) + 48) % 48; }
+
+/* Packet 'idx' turns off the previous packets note, then plays its own using several delta times:
+   note off @0ms, note on @1ms, CC1 @3ms, CC2 @23ms (running status, 2 byte delta) */
+static unsigned build_note_commands(unsigned char* cmds, int idx)
+{
+    unsigned pos = 0;
+    cmds[pos++]  = 0x80;
+    cmds[pos++]  = note_for_packet(idx - 1);
+    cmds[pos++]  = 0;
+    cmds[pos++]  = 10;
+    cmds[pos++]  = 0x90;
+    cmds[pos++]  = note_for_packet(idx);
+    cmds[pos++]  = 100;
+    cmds[pos++]  = 20;
+    cmds[pos++]  = 0xb0;
+    cmds[pos++]  = 1;
+    cmds[pos++]  = idx & 0x7f;
+    cmds[pos++]  = 0x81; /* 200 */
+    cmds[pos++]  = 0x48;
+    cmds[pos++]  = 2;
+    cmds[pos++]  = idx & 0x7f;
+    return pos;
+}
+
+/* Recovery journal for packet 'idx', checkpointed at 'idx - 2'. It describes packets 'idx - 2' and 'idx - 1':
+   note(idx - 1) is on, note(idx - 3) and note(idx - 2) are off */
+static unsigned build_note_journal(unsigned char* journal, int idx)
+{
+    unsigned char  offBits[16];
+    unsigned char  onNote = note_for_packet(idx - 1);
+    unsigned char  offNotes[2];
+    unsigned       low = 15, high = 0, pos = 0, i;
+    unsigned short checkpoint = idx - 2;
+
+    offNotes[0] = note_for_packet(idx - 3);
+    offNotes[1] = note_for_packet(idx - 2);
+    memset(offBits, 0, sizeof(offBits));
+    for (i = 0; i < 2; i++)
+    {
+        offBits[offNotes[i] / 8] |= 0x80 >> (offNotes[i] % 8);
+        if (offNotes[i] / 8 < low)
+            low = offNotes[i] / 8;
+        if (offNotes[i] / 8 > high)
+            high = offNotes[i] / 8;
+    }
+
+    /* Journal header: A=1, TOTCHAN=0 */
+    journal[pos++] = 0x20;
+    journal[pos++] = checkpoint >> 8;
+    journal[pos++] = checkpoint & 0xff;
+    /* Channel 0 journal, LENGTH, chapters: N */
+    journal[pos++] = 0x00;
+    journal[pos++] = 3 + 2 + 2 + (high - low + 1);
+    journal[pos++] = 0x08;
+    /* Chapter N: 1 note log, then OFFBITS */
+    journal[pos++] = 1;
+    journal[pos++] = (low << 4) | high;
+    journal[pos++] = onNote;
+    journal[pos++] = 0x80 | 100; /* Y=1 */
+    for (i = low; i <= high; i++)
+        journal[pos++] = offBits[i];
+    return pos;
+}
+
+/* Reads everything out of the ring, waiting up to 50ms for 'numExpected' packets to be handled */
+static void drain(MiniMIDI* mm, void (*onMessage)(MiniMIDIMessage))
+{
+    unsigned long long waitStartMs = now_ms();
+    while (now_ms() - waitStartMs < 50)
+    {
+        MiniMIDIMessage msg = minimidi_read_message(mm);
+        if (msg.status == 0)
+        {
+            MiniMIDINetStats stats = minimidi_net_get_stats(mm);
+            if (stats.numPackets + stats.numReordered >= numExpected)
+                break;
+            usleep(100);
+            continue;
+        }
+        onMessage(msg);
+    }
+    {
+        MiniMIDIMessage msg;
+        while ((msg = minimidi_read_message(mm)).status != 0)
+            onMessage(msg);
+    }
+}
+
+static unsigned      numRead          = 0;
+static unsigned      numDoubleTrigger = 0;
+static unsigned      numBadTimestamps = 0;
+static unsigned      lastNoteOnMs     = 0;
+static unsigned      lastNoteOffMs    = 0;
+static unsigned char heldNotes[128];
+
+static void on_note_message(MiniMIDIMessage msg)
+{
+    numRead++;
+    switch (msg.status)
+    {
+    case 0x80:
+        heldNotes[msg.data1] = 0;
+        lastNoteOffMs        = msg.timestampMs;
+        break;
+    case 0x90:
+        if (heldNotes[msg.data1])
+            numDoubleTrigger++;
+        heldNotes[msg.data1] = 1;
+        lastNoteOnMs         = msg.timestampMs;
+        break;
+    case 0xb0:
+        /* Journal replays come before a packets own commands, so the last note on/off are from this packet */
+        if (msg.data1 == 1 && (lastNoteOnMs - lastNoteOffMs != 1 || msg.timestampMs - lastNoteOnMs != 2))
+            numBadTimestamps++;
+        if (msg.data1 == 2 && msg.timestampMs - lastNoteOnMs != 22)
+            numBadTimestamps++;
+        break;
+    default:
+        CHECK(0, "unexpected message 0x%02x\n", msg.status);
+    }
+}
+
+static unsigned      numRestartRead = 0;
+static unsigned char restartNotes[4];
+
+static void on_restart_message(MiniMIDIMessage msg)
+{
+    if (numRestartRead < sizeof(restartNotes))
+        restartNotes[numRestartRead] = msg.data1;
+    numRestartRead++;
+}
+
+/* The sender restarts with the same SSRC and a much lower sequence number. The first packet after the jump is
+   dropped in case it's junk, then the second packet confirms the restart and is played */
+static void check_restart(MiniMIDI* mm)
+{
+    static const unsigned char notes[3][3] = {{0x90, 70, 100}, {0x90, 71, 100}, {0x90, 72, 100}};
+    MiniMIDINetStats           before      = minimidi_net_get_stats(mm);
+    MiniMIDINetStats           after;
+    int                        i;
+
+    nextSeq = 5;
+    for (i = 0; i < 3; i++)
+        send_commands(notes[i], sizeof(notes[i]), rtp_now());
+    numExpected--;
+    drain(mm, on_restart_message);
+    after = minimidi_net_get_stats(mm);
+
+    CHECK(
+        after.numPackets - before.numPackets == 2,
+        "%u packets after restart\n",
+        after.numPackets - before.numPackets);
+    CHECK(after.numLost - before.numLost == 1, "%u lost after restart\n", after.numLost - before.numLost);
+    CHECK(after.numReordered == before.numReordered, "%u reordered after restart\n", after.numReordered);
+    CHECK(
+        numRestartRead == 2 && restartNotes[0] == 71 && restartNotes[1] == 72,
+        "%u messages read after restart\n",
+        numRestartRead);
+}
+
+static unsigned numSyncRead  = 0;
+static unsigned numOtherRead = 0;
+static unsigned otherTimestamps[2];
+
+static void on_sync_message(MiniMIDIMessage msg)
+{
+    if (msg.status >= 0xf0)
+        numSyncRead++;
+    else if (numOtherRead++ < 2)
+        otherTimestamps[numOtherRead - 1] = msg.timestampMs;
+}
+
+/* Sends the next 'numClocks' at CLOCK_BPM in real time, with up to 1ms of jitter on each RTP timestamp.
+   Like a real master, the clock keeps its grid across Stop/Continue */
+static void send_clocks(MiniMIDI* mm, int numClocks)
+{
+    static const unsigned char clock[] = {0xf8};
+    static unsigned long long  clockStartMs;
+    static unsigned int        clockStartRtp;
+    static int                 clockIndex = 0;
+    int                        i;
+
+    if (clockIndex == 0)
+    {
+        clockStartMs  = now_ms();
+        clockStartRtp = rtp_now();
+    }
+    for (i = 0; i < numClocks; i++, clockIndex++)
+    {
+        double offsetMs = clockIndex * 60000.0 / (CLOCK_BPM * 24);
+        int    jitter   = rand() % 21 - 10;
+
+        while (now_ms() < clockStartMs + offsetMs)
+            usleep(500);
+        send_commands(clock, sizeof(clock), clockStartRtp + offsetMs * (MINIMIDI_NET_CLOCK_RATE / 1000) + jitter);
+        drain(mm, on_sync_message);
+    }
+}
+
+static void check_transport(MiniMIDI* mm)
+{
+    static const unsigned char start[]        = {0xfa};
+    static const unsigned char stop[]         = {0xfc};
+    static const unsigned char cont[]         = {0xfb};
+    static const unsigned char songPosition[] = {0xf2, 16, 0}; /* 16 sixteenths = 4 quarter notes */
+    /* A marker note, then 01:02:03:04 at 30fps with 8ms between quarter frames. The first quarter frame arrives
+       with the marker */
+    static const unsigned char forwardFrames[] = {
+        0x90, 60,   100, 0,    0xf1, 0x04, 0x50, 0xf1, 0x10, 0x50, 0xf1, 0x23, 0x50, 0xf1, 0x30,
+        0x50, 0xf1, 0x42, 0x50, 0xf1, 0x50, 0x50, 0xf1, 0x61, 0x50, 0xf1, 0x76};
+    /* The same running backwards, at 01:02:03:05 */
+    static const unsigned char backwardFrames[] = {
+        0x90, 61,   100, 0,    0xf1, 0x76, 0x50, 0xf1, 0x61, 0x50, 0xf1, 0x50, 0x50, 0xf1, 0x42,
+        0x50, 0xf1, 0x30, 0x50, 0xf1, 0x23, 0x50, 0xf1, 0x10, 0x50, 0xf1, 0x05};
+    MiniMIDITransport          transport;
+
+    srand(1);
+    printf("Sending MIDI clock at %d bpm\n", CLOCK_BPM);
+
+    /* After Start the first clock marks beat 0, then every 24 clocks is a quarter note */
+    send_commands(start, sizeof(start), rtp_now());
+    send_clocks(mm, 49);
+    transport = minimidi_get_transport(mm);
+    printf(
+        "transport:  %.2f bpm, %.3f ppq, %s\n",
+        transport.bpm,
+        transport.ppqPosition,
+        transport.playing ? "playing" : "stopped");
+    CHECK(transport.playing, "not playing after Start\n");
+    CHECK(transport.ppqPosition == 2.0, "%.3f ppq after Start, expected 2\n", transport.ppqPosition);
+    CHECK(transport.bpm > CLOCK_BPM - 1 && transport.bpm < CLOCK_BPM + 1, "%.2f bpm\n", transport.bpm);
+
+    /* Stop then Continue without a Song Position resumes on the next clock, without repeating the last one */
+    send_commands(stop, sizeof(stop), rtp_now());
+    drain(mm, on_sync_message);
+    transport = minimidi_get_transport(mm);
+    CHECK(! transport.playing, "playing after Stop\n");
+    CHECK(transport.ppqPosition == 49 / 24.0, "%.3f ppq after Stop, expected 2.042\n", transport.ppqPosition);
+    send_commands(cont, sizeof(cont), rtp_now());
+    send_clocks(mm, 1);
+    transport = minimidi_get_transport(mm);
+    CHECK(transport.playing, "not playing after Continue\n");
+    CHECK(transport.ppqPosition == 49 / 24.0, "%.3f ppq after Continue, expected 2.042\n", transport.ppqPosition);
+
+    send_commands(stop, sizeof(stop), rtp_now());
+    send_commands(songPosition, sizeof(songPosition), rtp_now());
+    drain(mm, on_sync_message);
+    transport = minimidi_get_transport(mm);
+    CHECK(! transport.playing, "playing after Stop\n");
+    CHECK(transport.ppqPosition == 4.0, "%.3f ppq after Song Position, expected 4\n", transport.ppqPosition);
+
+    /* Continue resumes from the Song Position on the next clock */
+    send_commands(cont, sizeof(cont), rtp_now());
+    send_clocks(mm, 25);
+    transport = minimidi_get_transport(mm);
+    CHECK(transport.playing, "not playing after Continue\n");
+    CHECK(transport.ppqPosition == 5.0, "%.3f ppq after Continue, expected 5\n", transport.ppqPosition);
+    CHECK(transport.bpm > CLOCK_BPM - 1 && transport.bpm < CLOCK_BPM + 1, "%.2f bpm\n", transport.bpm);
+
+    send_commands(forwardFrames, sizeof(forwardFrames), rtp_now());
+    drain(mm, on_sync_message);
+    transport = minimidi_get_transport(mm);
+    printf(
+        "mtc:        %02u:%02u:%02u:%02u, rate type %u\n",
+        transport.hours,
+        transport.minutes,
+        transport.seconds,
+        transport.frames,
+        transport.frameRateType);
+    CHECK(
+        transport.mtcValid && transport.hours == 1 && transport.minutes == 2 && transport.seconds == 3 &&
+            transport.frames == 4 && transport.frameRateType == 3,
+        "MTC not assembled\n");
+    CHECK(
+        transport.mtcTimestampMs == otherTimestamps[0],
+        "MTC at %u ms, expected %u ms\n",
+        transport.mtcTimestampMs,
+        otherTimestamps[0]);
+
+    send_commands(backwardFrames, sizeof(backwardFrames), rtp_now());
+    drain(mm, on_sync_message);
+    transport = minimidi_get_transport(mm);
+    CHECK(
+        transport.mtcValid && transport.hours == 1 && transport.minutes == 2 && transport.seconds == 3 &&
+            transport.frames == 5 && transport.frameRateType == 3,
+        "MTC running backwards not assembled\n");
+    CHECK(
+        transport.mtcTimestampMs == otherTimestamps[1],
+        "MTC running backwards at %u ms, expected %u ms\n",
+        transport.mtcTimestampMs,
+        otherTimestamps[1]);
+
+    /* Sync messages are consumed by the tracker, only the marker notes reach the ring */
+    CHECK(numSyncRead == 0, "%u sync messages read from the ring\n", numSyncRead);
+    CHECK(numOtherRead == 2, "%u other messages read, expected 2\n", numOtherRead);
+}
+
+int main(int argc, char** argv)
+{
+    MiniMIDI*          mm;
+    MiniMIDINetStats   stats;
+    unsigned char      packets[BURST_SIZE][128];
+    unsigned           packetLens[BURST_SIZE];
+    unsigned short     udpPort  = argc > 1 ? (unsigned short)atoi(argv[1]) : 15004;
+    unsigned           numSwaps = 0, numHeld = 0;
+    unsigned long long endMs;
+    int                err, i, j;
+
+    mm  = minimidi_create();
+    err = minimidi_net_connect(mm, "127.0.0.1", udpPort);
+    if (err != 0)
+    {
+        printf("Failed listening on 127.0.0.1:%u!\n", udpPort);
+        return 1;
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(udpPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    printf("Sending %d packets to 127.0.0.1:%u\n", NUM_PACKETS, udpPort);
+    startMs = now_ms();
+
+    for (i = 0; i < NUM_PACKETS; i += BURST_SIZE)
+    {
+        for (j = 0; j < BURST_SIZE; j++)
+        {
+            unsigned char cmds[32], journal[32];
+            unsigned      cmdLen     = build_note_commands(cmds, i + j);
+            unsigned      journalLen = build_note_journal(journal, i + j);
+            packetLens[j] = build_packet(packets[j], i + j, rtp_now(), cmds, cmdLen, journal, journalLen);
+        }
+        for (j = 0; j < BURST_SIZE; j++)
+        {
+            /* Swap this packet with the next */
+            int idx = j;
+            if ((i + j) % SWAP_INTERVAL == 1 && j + 1 < BURST_SIZE)
+            {
+                idx = j + 1;
+                numSwaps++;
+            }
+            else if ((i + j) % SWAP_INTERVAL == 2 && j > 0)
+                idx = j - 1;
+            sendto(sock, packets[idx], packetLens[idx], 0, (struct sockaddr*)&addr, sizeof(addr));
+        }
+        numExpected += BURST_SIZE;
+        drain(mm, on_note_message);
+    }
+    endMs = now_ms();
+    stats = minimidi_net_get_stats(mm);
+
+    for (i = 0; i < 128; i++)
+        numHeld += heldNotes[i];
+
+    printf("packets:    %u received, %u lost, %u reordered\n", stats.numPackets, stats.numLost, stats.numReordered);
+    printf("messages:   %u received, %u recovered, %u read\n", stats.numMessages, stats.numRecovered, numRead);
+    printf("jitter:     %u us\n", stats.jitterUs);
+    printf(
+        "throughput: %.0f packets/s, %.0f messages/s\n",
+        stats.numPackets * 1e3 / (endMs - startMs + 1),
+        stats.numMessages * 1e3 / (endMs - startMs + 1));
+
+    /* Each swap drops the late packet, and recovers its note on and the note off before it */
+    CHECK(stats.numPackets == NUM_PACKETS - numSwaps, "%u packets received\n", stats.numPackets);
+    CHECK(stats.numLost == numSwaps, "%u packets lost, expected %u\n", stats.numLost, numSwaps);
+    CHECK(stats.numReordered == numSwaps, "%u packets reordered, expected %u\n", stats.numReordered, numSwaps);
+    CHECK(stats.numRecovered == numSwaps * 2, "%u recovered, expected %u\n", stats.numRecovered, numSwaps * 2);
+    CHECK(numRead == stats.numMessages + stats.numRecovered, "%u messages read\n", numRead);
+    CHECK(numDoubleTrigger == 0, "%u notes triggered while held\n", numDoubleTrigger);
+    CHECK(numBadTimestamps == 0, "%u messages with bad timestamps\n", numBadTimestamps);
+    CHECK(numHeld == 1 && heldNotes[note_for_packet(NUM_PACKETS - 1)], "%u notes left held\n", numHeld);
+
+    check_restart(mm);
+    check_transport(mm);
+
+    minimidi_free(mm);
+    close(sock);
+
+    printf(numFailures ? "FAILED\n" : "PASSED\n");
+    return numFailures != 0;
+}